@@ -42,7 +42,7 @@ main = shakeArgs (shakeOptions' (def :: DirCfg)) $ do
           & field @"name" .~ "clangDoc"
   let clangDocCPPSourceCfg =
         (def :: CPPSourceCfg)
-          & field @"fromInTarget" .~ ((<.> "cpp") <$> ["main", "ClangWrappers"])
+          & field @"fromInTarget" .~ ((<.> "cpp") <$> ["main", "ClangWrappers", "HeaderBatches", "LineTables", "PCHGroups", "SymbolSearch"])
   let clangDocCPPIncludeListing =
         (def :: CPPIncludeListing)
           & field @"fromInTarget" .~ ["."]
@@ -10,6 +10,19 @@ namespace clangw {
     return TranslationUnit(shared_from_this(), path, argv, argc, unsavedFiles, unsavedFilesN, flags);
   }
 
+  Diagnostic TranslationUnit::diagnosticAt(unsigned int i) {
+    assert(i < diagnosticCount());
+    return Diagnostic(clang_getDiagnostic(unsafeRaw(), i));
+  }
+
+  CompileCommands CompilationDatabase::allCommands() {
+    return CompileCommands(clang_CompilationDatabase_getAllCompileCommands(unsafeRaw()));
+  }
+
+  CompileCommands CompilationDatabase::commandsFor(const char* path) {
+    return CompileCommands(clang_CompilationDatabase_getCompileCommands(unsafeRaw(), path));
+  }
+
   const char* clangerr::what() const noexcept /*override*/ {
     return msg_;
   }
@@ -24,6 +24,11 @@ namespace clangw {
 
   class Index;
   class TranslationUnit;
+  class Diagnostic;
+
+  class CompilationDatabase;
+  class CompileCommands;
+  struct CompileCommand;
 
   namespace token {
     enum class Kind;
@@ -38,6 +43,8 @@ namespace clangw {
   class TokenArray;
 
   constexpr const char* describeClangError(const int code);
+  constexpr const char* describeClangSaveError(const int code);
+  constexpr const char* describeCompilationDatabaseError(const int code);
 }
 
 namespace clangw {
@@ -47,6 +54,10 @@ namespace clangw {
         code_(code),
         msg_(describeClangError(code))
       {}
+      clangerr(const int code, const char* msg) noexcept :
+        code_(code),
+        msg_(msg)
+      {}
       int code() const noexcept {
         return code_;
       }
@@ -262,6 +273,13 @@ namespace clangw {
       CXSourceRange extent() {
         return clang_getCursorExtent(raw);
       }
+      // file the cursor is spelled in
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__LOCATIONS.html
+      CXFile file() {
+        CXFile res = nullptr;
+        clang_getSpellingLocation(location(), &res, nullptr, nullptr, nullptr);
+        return res;
+      }
 
       CXCursor raw;
   };
@@ -281,8 +299,9 @@ namespace clangw {
 
       // diagnostics = errors + warnings
       // @|url https://clang.llvm.org/doxygen/group__CINDEX.html#ga51eb9b38c18743bf2d824c6230e61f93
-      Index(const bool unknownWhatPCH, const bool printDiagnostics) :
-        i_(clang_createIndex(unknownWhatPCH, printDiagnostics))
+      // excludeDeclarationsFromPCH = skip the declarations of a PCH when visiting the TUs that include it
+      Index(const bool excludeDeclarationsFromPCH, const bool printDiagnostics) :
+        i_(clang_createIndex(excludeDeclarationsFromPCH, printDiagnostics))
       {
         assert(i_ != nullptr);
       }
@@ -333,6 +352,12 @@ namespace clangw {
         return u_;
       }
 
+      // path of the main file
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__TRANSLATION__UNIT.html
+      String spelling() {
+        return String(clang_getTranslationUnitSpelling(unsafeRaw()));
+      }
+
       // @|url https://clang.llvm.org/doxygen/group__CINDEX__CURSOR__MANIP.html#gaec6e69127920785e74e4a517423f4391
       Cursor rootCursor() {
         return Cursor(clang_getTranslationUnitCursor(unsafeRaw()));
@@ -343,6 +368,43 @@ namespace clangw {
         return Cursor(clang_getCursor(unsafeRaw(), loc));
       }
 
+      // null only if @|{path does not exist: libclang looks it up on disk, not in the TU,
+      // use @|{contains to know whether the TU actually got to it
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__FILES.html
+      CXFile file(const char* path) {
+        return clang_getFile(unsafeRaw(), path);
+      }
+      // whether @|{f was loaded while parsing the TU
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__FILES.html
+      bool contains(CXFile f) {
+        size_t size = 0;
+        return f != nullptr && clang_getFileContents(unsafeRaw(), f, &size) != nullptr;
+      }
+      // whole contents of @|{f@|}, e.g. to tokenize one of the included files
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__LOCATIONS.html
+      CXSourceRange extentOf(CXFile f) {
+        size_t size = 0;
+        clang_getFileContents(unsafeRaw(), f, &size);
+        return clang_getRange(
+          clang_getLocationForOffset(unsafeRaw(), f, 0),
+          clang_getLocationForOffset(unsafeRaw(), f, static_cast<unsigned int>(size))
+        );
+      }
+
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__DIAG.html
+      unsigned int diagnosticCount() {
+        return clang_getNumDiagnostics(unsafeRaw());
+      }
+      Diagnostic diagnosticAt(unsigned int i);
+
+      // parse with @|{CXTranslationUnit_ForSerialization@|} to get a PCH out of this
+      // @|url https://clang.llvm.org/doxygen/group__CINDEX__TRANSLATION__UNIT.html
+      void save(const char* path) {
+        const int err = clang_saveTranslationUnit(unsafeRaw(), path, clang_defaultSaveOptions(unsafeRaw()));
+        if (err != CXSaveError_None)
+          throw clangerr(err, describeClangSaveError(err));
+      }
+
     private:
       friend class Index;
       TranslationUnit() :
@@ -371,6 +433,172 @@ namespace clangw {
   };
 
 
+  // assumes that @|{CXDiagnostic is a pointer type
+  // @|url https://clang.llvm.org/doxygen/group__CINDEX__DIAG.html
+  class Diagnostic {
+    public:
+      ~Diagnostic() {
+        if (d_ != nullptr)
+          clang_disposeDiagnostic(d_);
+      }
+
+      explicit Diagnostic(CXDiagnostic d) :
+        d_(d)
+      {
+        assert(d_ != nullptr);
+      }
+      mimpl_cpp_nocopy(Diagnostic)
+      mimpl_cpp_copy_and_swap(Diagnostic) {
+        using std::swap;
+        swap(a.d_, b.d_);
+      }
+
+      mimpl_any_const_getter(CXDiagnostic, Diagnostic, unsafeRaw) {
+        assert(d_ != nullptr);
+        return d_;
+      }
+
+      CXDiagnosticSeverity severity() {
+        return clang_getDiagnosticSeverity(unsafeRaw());
+      }
+      // errors and fatal errors
+      bool error() {
+        return severity() >= CXDiagnostic_Error;
+      }
+      bool fatal() {
+        return severity() == CXDiagnostic_Fatal;
+      }
+      CXSourceLocation location() {
+        return clang_getDiagnosticLocation(unsafeRaw());
+      }
+      CXFile file() {
+        CXFile res = nullptr;
+        clang_getSpellingLocation(location(), &res, nullptr, nullptr, nullptr);
+        return res;
+      }
+      String spelling() {
+        return String(clang_getDiagnosticSpelling(unsafeRaw()));
+      }
+      // the way an index that prints diagnostics does, location and all
+      String format() {
+        return String(clang_formatDiagnostic(unsafeRaw(), clang_defaultDiagnosticDisplayOptions()));
+      }
+
+    private:
+      Diagnostic() :
+        d_(nullptr)
+      {}
+
+      CXDiagnostic d_;
+  };
+
+  // assumes that @|{CXCompilationDatabase is a pointer type
+  // @|url https://clang.llvm.org/doxygen/group__COMPILATIONDB.html
+  class CompilationDatabase {
+    public:
+      ~CompilationDatabase() {
+        if (d_ != nullptr)
+          clang_CompilationDatabase_dispose(unsafeRaw());
+      }
+
+      // looks for compile_commands.json in @|{buildDir
+      explicit CompilationDatabase(const char* buildDir) :
+        d_(nullptr)
+      {
+        CXCompilationDatabase_Error err;
+        d_ = clang_CompilationDatabase_fromDirectory(buildDir, &err);
+        if (err != CXCompilationDatabase_NoError)
+          throw clangerr(err, describeCompilationDatabaseError(err));
+        assert(d_ != nullptr);
+      }
+
+      mimpl_cpp_nocopy(CompilationDatabase)
+      mimpl_cpp_copy_and_swap(CompilationDatabase) {
+        using std::swap;
+        swap(a.d_, b.d_);
+      }
+
+      mimpl_any_const_getter(CXCompilationDatabase, CompilationDatabase, unsafeRaw) {
+        assert(d_ != nullptr);
+        return d_;
+      }
+
+      CompileCommands allCommands();
+      CompileCommands commandsFor(const char* path);
+
+    private:
+      CompilationDatabase() :
+        d_(nullptr)
+      {}
+
+      CXCompilationDatabase d_;
+  };
+
+  // Does not own anything, only valid as long as the @|{CompileCommands it came from.
+  struct CompileCommand {
+    public:
+      CompileCommand(CXCompileCommand c) :
+        raw(c)
+      {}
+
+      String directory() {
+        return String(clang_CompileCommand_getDirectory(raw));
+      }
+      String filename() {
+        return String(clang_CompileCommand_getFilename(raw));
+      }
+
+      // argument 0 is the compiler
+      unsigned int argCount() {
+        return clang_CompileCommand_getNumArgs(raw);
+      }
+      String argAt(unsigned int i) {
+        assert(i < argCount());
+        return String(clang_CompileCommand_getArg(raw, i));
+      }
+
+      CXCompileCommand raw;
+  };
+
+  // assumes that @|{CXCompileCommands is a pointer type
+  class CompileCommands {
+    public:
+      ~CompileCommands() {
+        if (c_ != nullptr)
+          clang_CompileCommands_dispose(c_);
+      }
+
+      mimpl_cpp_nocopy(CompileCommands)
+      mimpl_cpp_copy_and_swap(CompileCommands) {
+        using std::swap;
+        swap(a.c_, b.c_);
+      }
+
+      // a null @|{CXCompileCommands is how libclang says "no commands"
+      unsigned int size() const {
+        if (c_ == nullptr)
+          return 0;
+        return clang_CompileCommands_getSize(c_);
+      }
+
+      CompileCommand commandAt(unsigned int i) {
+        assert(i < size());
+        return CompileCommand(clang_CompileCommands_getCommand(c_, i));
+      }
+
+    private:
+      friend class CompilationDatabase;
+      CompileCommands() :
+        c_(nullptr)
+      {}
+      explicit CompileCommands(CXCompileCommands c) :
+        c_(c)
+      {}
+
+      CXCompileCommands c_;
+  };
+
+
   namespace token {
     // @|url https://clang.llvm.org/doxygen/group__CINDEX__LEX.html#gaf63e37eee4280e2c039829af24bbc201
     enum class Kind {
@@ -605,4 +833,24 @@ namespace clangw {
       return "An AST deserialization error has occurred.";
     return "Unknown error.";
   }
+
+  // @|url https://clang.llvm.org/doxygen/group__CINDEX__TRANSLATION__UNIT.html
+  constexpr const char* describeClangSaveError(const int code) {
+    assert(code != CXSaveError_None);
+    if (code == CXSaveError_Unknown)
+      return "An unknown error occurred while attempting to save the file.";
+    if (code == CXSaveError_TranslationErrors)
+      return "Errors during translation prevented the translation unit from being saved.";
+    if (code == CXSaveError_InvalidTU)
+      return "The translation unit to be saved was invalid.";
+    return "Unknown error.";
+  }
+
+  // @|url https://clang.llvm.org/doxygen/group__COMPILATIONDB.html
+  constexpr const char* describeCompilationDatabaseError(const int code) {
+    assert(code != CXCompilationDatabase_NoError);
+    if (code == CXCompilationDatabase_CanNotLoadDatabase)
+      return "The compilation database could not be loaded.";
+    return "Unknown error.";
+  }
 }
@@ -0,0 +1,170 @@
+#include "HeaderBatches.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace clangdoc {
+  namespace {
+    std::vector<const char*> toArgv(const std::vector<std::string>& flags) {
+      std::vector<const char*> res;
+      for (const std::string& f : flags)
+        res.push_back(f.c_str());
+      return res;
+    }
+
+    // false if the header does not parse
+    bool documentAlone(
+      clangw::Index& i,
+      const std::string& header,
+      const std::vector<std::string>& flags,
+      HeaderDocumenter* doc
+    ) {
+      const std::vector<const char*> argv = toArgv(flags);
+      std::shared_ptr<clangw::TranslationUnit> tu;
+      try {
+        tu = std::make_shared<clangw::TranslationUnit>(i.makeTranslationUnit(
+          header.c_str(),
+          argv.data(), static_cast<int>(argv.size()),
+          nullptr, 0
+        ));
+      }
+      catch (const clangw::clangerr& e) {
+        std::cerr << "clangDoc: skipping " << header << ": " << e.what() << '\n';
+        return false;
+      }
+
+      doc(tu, nullptr);
+      return true;
+    }
+
+    // @|{umbrellaIndex does not print diagnostics, the ones of headers that get parsed again on their own
+    // would show up twice
+    bool documentBatch(
+      clangw::Index& i,
+      clangw::Index& umbrellaIndex,
+      const std::vector<std::string>& batch,
+      const std::vector<std::string>& flags,
+      HeaderDocumenter* doc
+    ) {
+      if (batch.size() == 1)
+        return documentAlone(i, batch.front(), flags, doc);
+
+      // same extension as the headers so that the language is guessed the same as for a lone header
+      const std::string umbrellaPath = "clangDoc-umbrella" + fs::path(batch.front()).extension().string();
+      std::vector<std::string> absolutePaths;
+      std::string umbrella;
+      for (const std::string& h : batch) {
+        absolutePaths.push_back(fs::absolute(h).lexically_normal().string());
+        umbrella += "#include \"" + absolutePaths.back() + "\"\n";
+      }
+
+      CXUnsavedFile unsaved;
+      unsaved.Filename = umbrellaPath.c_str();
+      unsaved.Contents = umbrella.c_str();
+      unsaved.Length = umbrella.size();
+
+      const std::vector<const char*> argv = toArgv(flags);
+      std::shared_ptr<clangw::TranslationUnit> tu;
+      try {
+        tu = std::make_shared<clangw::TranslationUnit>(umbrellaIndex.makeTranslationUnit(
+          umbrellaPath.c_str(),
+          argv.data(), static_cast<int>(argv.size()),
+          &unsaved, 1
+        ));
+      }
+      catch (const clangw::clangerr& e) {
+        std::cerr << "clangDoc: umbrella parse failed, parsing headers one by one: " << e.what() << '\n';
+        bool ok = true;
+        for (const std::string& h : batch)
+          ok = documentAlone(i, h, flags, doc) && ok;
+        return ok;
+      }
+
+      std::vector<CXFile> files;
+      for (const std::string& h : absolutePaths)
+        files.push_back(tu->file(h.c_str()));
+
+      std::vector<bool> alone(batch.size(), false);
+      for (size_t n = 0; n < batch.size(); ++n)
+        if (!tu->contains(files[n]))
+          alone[n] = true;
+
+      for (unsigned int d = 0; d < tu->diagnosticCount(); ++d) {
+        clangw::Diagnostic diag = tu->diagnosticAt(d);
+        if (!diag.error())
+          continue;
+
+        // parsing stopped there: later headers may be missing or have had their errors suppressed
+        if (diag.fatal()) {
+          std::fill(alone.begin(), alone.end(), true);
+          break;
+        }
+
+        const CXFile f = diag.file();
+        const auto culprit = std::find_if(files.begin(), files.end(), [f](CXFile h) {
+          return f != nullptr && h != nullptr && clang_File_isEqual(f, h) != 0;
+        });
+        if (culprit == files.end()) {
+          std::fill(alone.begin(), alone.end(), true);
+          break;
+        }
+        alone[static_cast<size_t>(culprit - files.begin())] = true;
+      }
+
+      // the rest comes from parsing the headers again
+      if (std::find(alone.begin(), alone.end(), false) != alone.end()) {
+        for (unsigned int d = 0; d < tu->diagnosticCount(); ++d) {
+          clangw::Diagnostic diag = tu->diagnosticAt(d);
+          const CXFile f = diag.file();
+          bool reparsed = false;
+          for (size_t n = 0; n < batch.size() && !reparsed; ++n)
+            reparsed = alone[n] && f != nullptr && files[n] != nullptr && clang_File_isEqual(f, files[n]) != 0;
+          if (!reparsed)
+            std::cerr << diag.format().cstr() << '\n';
+        }
+      }
+
+      bool ok = true;
+      for (size_t n = 0; n < batch.size(); ++n) {
+        if (alone[n])
+          ok = documentAlone(i, batch[n], flags, doc) && ok;
+        else
+          doc(tu, files[n]);
+      }
+      return ok;
+    }
+  }
+
+  bool documentHeaders(
+    clangw::Index& i,
+    const std::vector<std::string>& headers,
+    const std::vector<std::string>& flags,
+    size_t batchSize,
+    HeaderDocumenter* doc
+  ) {
+    batchSize = std::max<size_t>(batchSize, 1);
+    const std::shared_ptr<clangw::Index> umbrellaIndex = std::make_shared<clangw::Index>(true, false);
+    bool ok = true;
+
+    // a batch only holds headers with the same extension, see the umbrella name in @|{documentBatch
+    std::vector<std::string> batch;
+    auto flush = [&]() {
+      if (!batch.empty())
+        ok = documentBatch(i, *umbrellaIndex, batch, flags, doc) && ok;
+      batch.clear();
+    };
+
+    for (const std::string& h : headers) {
+      if (!batch.empty() && fs::path(batch.front()).extension() != fs::path(h).extension())
+        flush();
+      batch.push_back(h);
+      if (batch.size() == batchSize)
+        flush();
+    }
+    flush();
+    return ok;
+  }
+}
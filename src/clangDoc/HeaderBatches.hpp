@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClangWrappers.hpp"
+
+namespace clangdoc {
+  // Documents one header. @|{header is null when the header is the TU's main file,
+  // otherwise only the parts of the TU that come from @|{header are of interest.
+  using HeaderDocumenter = void (std::shared_ptr<clangw::TranslationUnit> tu, CXFile header);
+
+  // Parses the headers @|{batchSize at a time through a synthetic umbrella file that includes them
+  // all, so that whatever they have in common (the standard library, usually) is parsed once per
+  // batch instead of once per header.
+  // Headers that get errors inside the umbrella, or that do not make it into it, are parsed on their
+  // own instead. A fatal error, or an error that cannot be pinned on one of the headers, sends the whole
+  // batch down that path.
+  // Umbrellas are parsed on an index of their own that does not print diagnostics; only those that do
+  // not come up again when a header is parsed on its own get printed.
+  // The headers are documented in the order given. Headers that do not parse at all are reported and
+  // skipped, and the result is false.
+  bool documentHeaders(
+    clangw::Index& i,
+    const std::vector<std::string>& headers,
+    const std::vector<std::string>& flags,
+    size_t batchSize,
+    HeaderDocumenter* doc
+  );
+}
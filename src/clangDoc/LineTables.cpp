@@ -0,0 +1,113 @@
+#include "LineTables.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace clangdoc {
+  LineTable::LineTable(const char* contents, size_t size) :
+    lineStarts_{0}
+  {
+    // "\r\n" is only counted at the "\r"
+    size_t skip = size;
+    const auto lineEndAt = [&](size_t i) {
+      if (i == skip)
+        return;
+      if (contents[i] == '\r' && i + 1 < size && contents[i + 1] == '\n') {
+        skip = i + 1;
+        lineStarts_.push_back(static_cast<std::uint32_t>(i + 2));
+      }
+      else
+        lineStarts_.push_back(static_cast<std::uint32_t>(i + 1));
+    };
+
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; i + 16 <= size; i += 16) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(contents + i));
+      unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr))
+      ));
+      while (mask != 0) {
+        lineEndAt(i + static_cast<size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; i < size; ++i)
+      if (contents[i] == '\n' || contents[i] == '\r')
+        lineEndAt(i);
+  }
+
+  unsigned int LineTable::lineOf(std::uint32_t offset) const {
+    // last line start <= offset; the comparison turns into a conditional move, not a branch
+    const std::uint32_t* base = lineStarts_.data();
+    size_t n = lineStarts_.size();
+    while (n > 1) {
+      const size_t half = n / 2;
+      base = base[half] <= offset ? base + half : base;
+      n -= half;
+    }
+    return static_cast<unsigned int>(base - lineStarts_.data()) + 1;
+  }
+
+  const LineTable* LocationDecoder::tableFor_(CXFile f) {
+    if (f == lastFile_)
+      return lastTable_;
+
+    auto it = tables_.find(f);
+    if (it == tables_.end()) {
+      size_t size = 0;
+      const char* contents = clang_getFileContents(tu_->unsafeRaw(), f, &size);
+      it = tables_.emplace(f, contents == nullptr ? nullptr : std::make_unique<LineTable>(contents, size)).first;
+    }
+
+    lastFile_ = f;
+    lastTable_ = it->second.get();
+    return lastTable_;
+  }
+
+  DecodedLocation LocationDecoder::decode(CXSourceLocation loc) {
+    DecodedLocation res{nullptr, 0, 0, 0};
+    clang_getSpellingLocation(loc, &res.file, nullptr, nullptr, &res.offset);
+    if (res.file == nullptr && clang_equalLocations(loc, clang_getNullLocation()) != 0)
+      return res;
+
+    // no file (scratch space, built-ins) or no contents: ask libclang
+    const LineTable* table = res.file == nullptr ? nullptr : tableFor_(res.file);
+    if (table == nullptr) {
+      clang_getSpellingLocation(loc, nullptr, &res.line, &res.column, nullptr);
+      return res;
+    }
+
+    res.line = table->lineOf(res.offset);
+    res.column = table->columnOf(res.offset, res.line);
+    return res;
+  }
+
+  void LocationDecoder::decodeTokenLocations(clangw::TokenArray& ta, std::vector<DecodedLocation>& out) {
+    out.resize(ta.size());
+    for (unsigned int i = 0; i < ta.size(); ++i)
+      out[i] = decode(ta.locationOfTokenAt(i));
+  }
+
+  void LocationDecoder::decodeTokenExtents(clangw::TokenArray& ta, std::vector<DecodedRange>& out) {
+    out.resize(ta.size());
+    for (unsigned int i = 0; i < ta.size(); ++i)
+      out[i] = decode(ta.extentOfTokenAt(i));
+  }
+
+  void LocationDecoder::decodeCursorLocations(clangw::Cursor* cursors, size_t n, std::vector<DecodedLocation>& out) {
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      out[i] = decode(cursors[i].location());
+  }
+
+  void LocationDecoder::decodeCursorExtents(clangw::Cursor* cursors, size_t n, std::vector<DecodedRange>& out) {
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      out[i] = decode(cursors[i].extent());
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ClangWrappers.hpp"
+
+namespace clangdoc {
+  // What @|{clang_getSpellingLocation@|} gives back. All zeroes for an invalid location.
+  // @|{file is also null for valid locations spelled in a buffer that is not a file, like the
+  // scratch space of @|{##@|} or @|{<built-in>@|}, which still have a line and column.
+  struct DecodedLocation {
+    CXFile file;
+    unsigned int line;
+    unsigned int column;
+    unsigned int offset;
+  };
+
+  struct DecodedRange {
+    DecodedLocation begin;
+    DecodedLocation end;
+  };
+
+  // Offsets at which the lines of one file start.
+  // Line ends are the same as clang's (13 and later): "\n", "\r" and "\r\n".
+  // "\n\r" is two line ends, as clang counts it since @|{LineOffsetMapping::get@|}.
+  class LineTable {
+    public:
+      LineTable(const char* contents, size_t size);
+
+      // 1-based, like clang
+      unsigned int lineOf(std::uint32_t offset) const;
+      unsigned int columnOf(std::uint32_t offset, unsigned int line) const {
+        return offset - lineStarts_[line - 1] + 1;
+      }
+
+    private:
+      std::vector<std::uint32_t> lineStarts_;
+  };
+
+  // Decodes source locations of one TU with a single libclang call each, for the file and offset,
+  // instead of having libclang work out the line and column every time.
+  // Line tables are built the first time a file is seen.
+  class LocationDecoder {
+    public:
+      explicit LocationDecoder(std::shared_ptr<clangw::TranslationUnit> tu) :
+        tu_(std::move(tu)),
+        lastFile_(nullptr),
+        lastTable_(nullptr)
+      {}
+
+      DecodedLocation decode(CXSourceLocation loc);
+      DecodedRange decode(CXSourceRange range) {
+        return DecodedRange{decode(clang_getRangeStart(range)), decode(clang_getRangeEnd(range))};
+      }
+
+      // @|{out[i]@|} is for token or cursor @|{i
+      void decodeTokenLocations(clangw::TokenArray& ta, std::vector<DecodedLocation>& out);
+      void decodeTokenExtents(clangw::TokenArray& ta, std::vector<DecodedRange>& out);
+      void decodeCursorLocations(clangw::Cursor* cursors, size_t n, std::vector<DecodedLocation>& out);
+      void decodeCursorExtents(clangw::Cursor* cursors, size_t n, std::vector<DecodedRange>& out);
+
+    private:
+      // null if libclang does not have the contents of @|{f
+      const LineTable* tableFor_(CXFile f);
+
+      std::shared_ptr<clangw::TranslationUnit> tu_;
+      std::unordered_map<CXFile, std::unique_ptr<LineTable>> tables_;
+      // tokens and cursors come in runs from the same file
+      CXFile lastFile_;
+      const LineTable* lastTable_;
+  };
+}
@@ -0,0 +1,290 @@
+#include "PCHGroups.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace clangdoc {
+  namespace {
+    // flags taking a path, either as the next argument or glued on
+    // longer spellings go first so that "-I" does not eat "-isystem" and friends
+    constexpr const char* pathFlags[] = {
+      "-idirafter", "-isystem", "-iquote", "-imacros", "-include-pch", "-include", "-I"
+    };
+    // flags taking a (non-path) argument that only matter for the build outputs
+    constexpr const char* droppedFlagsWithArg[] = {
+      "-o", "-MF", "-MT", "-MQ"
+    };
+    constexpr const char* droppedFlags[] = {
+      "-c", "-M", "-MM", "-MD", "-MMD", "-MP"
+    };
+
+    std::string absolutePath(const std::string& dir, const std::string& p) {
+      fs::path res(p);
+      if (res.is_relative())
+        res = fs::path(dir) / res;
+      return res.lexically_normal().string();
+    }
+
+    bool startsWith(const std::string& s, const char* prefix) {
+      return s.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    CompileJob normalize(clangw::CompileCommand c) {
+      const std::string dir = c.directory().cstr();
+
+      CompileJob res;
+      res.path = absolutePath(dir, c.filename().cstr());
+
+      // for every other relative path (-isysroot, -F, -ivfsoverlay, inputs, ...), and part of the group key,
+      // so jobs from different directories never share a PCH
+      res.flags.push_back("-working-directory=" + dir);
+
+      const unsigned int n = c.argCount();
+      // skip the compiler
+      for (unsigned int i = 1; i < n; ++i) {
+        const std::string a = c.argAt(i).cstr();
+        if (a.empty())
+          continue;
+
+        if (std::find(std::begin(droppedFlags), std::end(droppedFlags), a) != std::end(droppedFlags))
+          continue;
+        if (std::find(std::begin(droppedFlagsWithArg), std::end(droppedFlagsWithArg), a) != std::end(droppedFlagsWithArg)) {
+          ++i;
+          continue;
+        }
+        if (a.size() > 2 && startsWith(a, "-o"))
+          continue;
+        if (a[0] != '-' && absolutePath(dir, a) == res.path)
+          continue;
+
+        bool isPathFlag = false;
+        for (const char* f : pathFlags) {
+          if (!startsWith(a, f))
+            continue;
+          isPathFlag = true;
+
+          res.flags.emplace_back(f);
+          if (a.size() == std::strlen(f)) {
+            if (i + 1 < n)
+              res.flags.push_back(absolutePath(dir, c.argAt(++i).cstr()));
+          }
+          else
+            res.flags.back() += absolutePath(dir, a.substr(std::strlen(f)));
+          break;
+        }
+        if (!isPathFlag)
+          res.flags.push_back(a);
+      }
+
+      return res;
+    }
+
+    std::string trimLeft(const std::string& s) {
+      const size_t start = s.find_first_not_of(" \t\r");
+      if (start == std::string::npos)
+        return "";
+      return s.substr(start);
+    }
+
+    // Leading @|{#include <...>@|} lines of a file, up to the first line that is anything else.
+    // Quoted includes end the prefix too, since they resolve relative to the including file.
+    std::vector<std::string> readIncludePrefix(const std::string& path) {
+      std::vector<std::string> res;
+
+      std::ifstream in(path);
+      std::string line;
+      bool inBlockComment = false;
+      while (std::getline(in, line)) {
+        while (true) {
+          if (inBlockComment) {
+            const size_t end = line.find("*/");
+            if (end == std::string::npos)
+              break;
+            line = line.substr(end + 2);
+            inBlockComment = false;
+          }
+
+          line = trimLeft(line);
+          if (startsWith(line, "/*")) {
+            line = line.substr(2);
+            inBlockComment = true;
+            continue;
+          }
+          break;
+        }
+        if (inBlockComment || line.empty() || startsWith(line, "//"))
+          continue;
+
+        if (line[0] != '#')
+          return res;
+        line = trimLeft(line.substr(1));
+        if (startsWith(line, "pragma") && trimLeft(line.substr(6)).compare(0, 4, "once") == 0)
+          continue;
+        if (!startsWith(line, "include"))
+          return res;
+
+        line = trimLeft(line.substr(7));
+        const size_t end = line.find('>');
+        if (line.empty() || line[0] != '<' || end == std::string::npos)
+          return res;
+        res.push_back("#include " + line.substr(0, end + 1));
+      }
+
+      return res;
+    }
+
+    std::string groupKey(const std::vector<std::string>& flags) {
+      std::string res;
+      for (const std::string& f : flags) {
+        res += f;
+        res += '\0';
+      }
+      return res;
+    }
+
+    // Input language of a job, "c" or "c++" when it can share a PCH and empty otherwise.
+    // The last -x wins over the extension, like in the driver.
+    std::string pchLanguageOf(const CompileJob& job) {
+      std::string lang;
+      for (size_t i = 0; i < job.flags.size(); ++i) {
+        if (job.flags[i] == "-x" && i + 1 < job.flags.size())
+          lang = job.flags[++i];
+        else if (job.flags[i].size() > 2 && startsWith(job.flags[i], "-x"))
+          lang = job.flags[i].substr(2);
+      }
+
+      if (lang.empty()) {
+        const std::string ext = fs::path(job.path).extension().string();
+        if (ext == ".c")
+          lang = "c";
+        else if (ext == ".cc" || ext == ".cpp" || ext == ".cxx" || ext == ".c++" || ext == ".C")
+          lang = "c++";
+      }
+
+      if (lang != "c" && lang != "c++")
+        return "";
+      return lang;
+    }
+  }
+
+  std::vector<CompileJob> readCompileJobs(clangw::CompilationDatabase& db) {
+    clangw::CompileCommands cmds = db.allCommands();
+
+    std::vector<CompileJob> res;
+    res.reserve(cmds.size());
+    for (unsigned int i = 0; i < cmds.size(); ++i)
+      res.push_back(normalize(cmds.commandAt(i)));
+    return res;
+  }
+
+  std::vector<PCHGroup> groupCompileJobs(std::vector<CompileJob>&& jobs) {
+    std::vector<PCHGroup> res;
+    std::map<std::string, size_t> groupIndices;
+
+    for (CompileJob& job : jobs) {
+      // C and C++ files cannot share a PCH even with identical flags
+      const std::string language = pchLanguageOf(job);
+      const std::string key = language + "\n" + groupKey(job.flags);
+
+      auto it = groupIndices.find(key);
+      if (it == groupIndices.end()) {
+        it = groupIndices.emplace(key, res.size()).first;
+        res.emplace_back();
+        res.back().language = language;
+        res.back().flags = job.flags;
+        res.back().includePrefix = readIncludePrefix(job.path);
+      }
+      else {
+        std::vector<std::string>& prefix = res[it->second].includePrefix;
+        const std::vector<std::string> own = readIncludePrefix(job.path);
+        const auto mismatch = std::mismatch(prefix.begin(), prefix.end(), own.begin(), own.end());
+        prefix.erase(mismatch.first, prefix.end());
+      }
+
+      res[it->second].jobs.push_back(std::move(job));
+    }
+
+    return res;
+  }
+
+  void buildGroupPCH(clangw::Index& i, PCHGroup& g, const std::string& outDir) {
+    g.pchPath.clear();
+    if (g.language.empty() || g.jobs.size() < 2 || g.includePrefix.empty())
+      return;
+
+    const bool c = g.language == "c";
+    const std::string key = g.language + "\n" + groupKey(g.flags);
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016zx", std::hash<std::string>()(key));
+
+    // absolute, the flags set a working directory of their own
+    const fs::path dir = fs::absolute(outDir);
+    fs::create_directories(dir);
+    const std::string headerPath = (dir / name).string() + (c ? ".h" : ".hpp");
+    const std::string pchPath = (dir / name).string() + ".pch";
+    {
+      std::ofstream out(headerPath);
+      for (const std::string& line : g.includePrefix)
+        out << line << '\n';
+    }
+
+    std::vector<const char*> argv;
+    for (const std::string& f : g.flags)
+      argv.push_back(f.c_str());
+    argv.push_back("-x");
+    argv.push_back(c ? "c-header" : "c++-header");
+
+    try {
+      clangw::TranslationUnit tu = i.makeTranslationUnit(
+        headerPath.c_str(),
+        argv.data(), static_cast<int>(argv.size()),
+        nullptr, 0,
+        CXTranslationUnit_ForSerialization | CXTranslationUnit_Incomplete
+      );
+      tu.save(pchPath.c_str());
+    }
+    catch (const clangw::clangerr& e) {
+      std::cerr << "clangDoc: not using a PCH for " << headerPath << ": " << e.what() << '\n';
+      return;
+    }
+
+    g.pchPath = pchPath;
+  }
+
+  clangw::TranslationUnit parseInGroup(clangw::Index& i, const PCHGroup& g, const CompileJob& job) {
+    std::vector<const char*> argv;
+    for (const std::string& f : job.flags)
+      argv.push_back(f.c_str());
+
+    if (!g.pchPath.empty()) {
+      std::vector<const char*> pchArgv = argv;
+      pchArgv.push_back("-include-pch");
+      pchArgv.push_back(g.pchPath.c_str());
+
+      try {
+        return i.makeTranslationUnit(
+          job.path.c_str(),
+          pchArgv.data(), static_cast<int>(pchArgv.size()),
+          nullptr, 0
+        );
+      }
+      catch (const clangw::clangerr& e) {
+        std::cerr << "clangDoc: parsing " << job.path << " again without " << g.pchPath << ": " << e.what() << '\n';
+      }
+    }
+
+    return i.makeTranslationUnit(
+      job.path.c_str(),
+      argv.data(), static_cast<int>(argv.size()),
+      nullptr, 0
+    );
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ClangWrappers.hpp"
+
+namespace clangdoc {
+  // One compilation database entry. Flags are normalized so that two files built the same way
+  // get equal flag lists: no compiler, no source file, no output flags, absolute include paths.
+  // They start with @|{-working-directory@|} for the command's directory, which any other relative
+  // path resolves against.
+  struct CompileJob {
+    std::string path;
+    std::vector<std::string> flags;
+  };
+
+  // Jobs that share their flags. Their common run of leading @|{#include <...>@|} lines is
+  // precompiled once and every job is then parsed against the PCH.
+  struct PCHGroup {
+    // "c" or "c++", empty for anything else (Objective-C, CUDA, ...), which never gets a PCH
+    std::string language;
+    std::vector<std::string> flags;
+    std::vector<std::string> includePrefix;
+    std::vector<CompileJob> jobs;
+    // empty if the group is parsed without a PCH
+    std::string pchPath;
+  };
+
+  std::vector<CompileJob> readCompileJobs(clangw::CompilationDatabase& db);
+  std::vector<PCHGroup> groupCompileJobs(std::vector<CompileJob>&& jobs);
+
+  // Writes the prefix header and its PCH into @|{outDir and sets @|{g.pchPath@|}.
+  // Groups that are not C or C++, have a single job or no common prefix are left without a PCH,
+  // as is any group whose prefix fails to compile on its own.
+  void buildGroupPCH(clangw::Index& i, PCHGroup& g, const std::string& outDir);
+
+  // Jobs whose parse against the PCH fails (a stale PCH, flags the PCH does not validate against, ...)
+  // are parsed again without it.
+  clangw::TranslationUnit parseInGroup(clangw::Index& i, const PCHGroup& g, const CompileJob& job);
+}
@@ -0,0 +1,751 @@
+#include "SymbolSearch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace clangdoc {
+  namespace {
+    constexpr char magic[8] = {'c', 'l', 'D', 'o', 'c', 'T', 'g', '2'};
+    constexpr std::uint32_t blockSize = 128;
+
+    // TrigramEntry[count], sorted by trigram, then the posting lists
+    struct TrigramSection {
+      std::uint64_t offset;
+      std::uint64_t count;
+      std::uint64_t postingsSize; // in bytes
+    };
+
+    // All sections start 8-byte aligned, offsets are from the start of the file.
+    struct FileHeader {
+      char magic[8];
+      std::uint32_t symbolCount;
+      std::uint32_t tuCount;
+      TrigramSection qualifiedNameTrigrams;
+      TrigramSection nameTrigrams;
+      std::uint64_t nameOrderOffset; // SymbolId[symbolCount], sorted by case-folded name
+      std::uint64_t symbolsOffset; // SymbolRecord[symbolCount]
+      std::uint64_t tusOffset; // StringRef[tuCount]
+      std::uint64_t stringsOffset;
+      std::uint64_t stringsSize;
+    };
+
+    struct StringRef {
+      std::uint32_t offset; // into the strings section
+      std::uint32_t size;
+    };
+
+    struct SymbolRecord {
+      StringRef name;
+      StringRef qualifiedName;
+      std::uint32_t tu;
+    };
+
+    // A posting list is BlockHeader[ceil(count / blockSize)] followed by the packed gaps of every
+    // block and two padding words, so that unpacking can always read two words at a time,
+    // even past the end of a block packed at width 0.
+    struct TrigramEntry {
+      std::uint32_t trigram;
+      std::uint32_t count;
+      std::uint64_t offset; // from the end of the entries, 4-byte aligned
+    };
+
+    struct BlockHeader {
+      std::uint32_t first;
+      std::uint32_t last;
+      std::uint32_t wordOffset; // from the end of the block headers
+      std::uint32_t width;
+    };
+
+    const FileHeader& headerOf(const unsigned char* data) {
+      return *reinterpret_cast<const FileHeader*>(data);
+    }
+
+    const SymbolRecord& symbolAt(const unsigned char* data, SymbolId id) {
+      return reinterpret_cast<const SymbolRecord*>(data + headerOf(data).symbolsOffset)[id];
+    }
+
+    std::string_view stringAt(const unsigned char* data, StringRef s) {
+      return std::string_view(reinterpret_cast<const char*>(data + headerOf(data).stringsOffset + s.offset), s.size);
+    }
+
+    char foldCase(char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    std::string foldCase(std::string_view s) {
+      std::string res(s);
+      std::transform(res.begin(), res.end(), res.begin(), [](char c) { return foldCase(c); });
+      return res;
+    }
+
+    // The following take @|{folded already case-folded and fold @|{s on the fly, so that checking
+    // a candidate does not allocate.
+
+    // like @|{std::string::compare@|}, bytes compare unsigned
+    int compareFolded(std::string_view s, std::string_view folded) {
+      const size_t n = std::min(s.size(), folded.size());
+      for (size_t i = 0; i < n; ++i) {
+        const unsigned char a = static_cast<unsigned char>(foldCase(s[i]));
+        const unsigned char b = static_cast<unsigned char>(folded[i]);
+        if (a != b)
+          return a < b ? -1 : 1;
+      }
+      if (s.size() == folded.size())
+        return 0;
+      return s.size() < folded.size() ? -1 : 1;
+    }
+
+    bool startsWithFolded(std::string_view s, std::string_view folded) {
+      return s.size() >= folded.size() && compareFolded(s.substr(0, folded.size()), folded) == 0;
+    }
+
+    bool containsFolded(std::string_view s, std::string_view folded) {
+      return std::search(s.begin(), s.end(), folded.begin(), folded.end(), [](char a, char b) {
+        return foldCase(a) == b;
+      }) != s.end();
+    }
+
+    std::uint32_t trigramAt(std::string_view folded, size_t i) {
+      return
+        static_cast<std::uint32_t>(static_cast<unsigned char>(folded[i])) << 16 |
+        static_cast<std::uint32_t>(static_cast<unsigned char>(folded[i + 1])) << 8 |
+        static_cast<std::uint32_t>(static_cast<unsigned char>(folded[i + 2]));
+    }
+
+    std::uint32_t bitWidth(std::uint32_t x) {
+      std::uint32_t res = 0;
+      while (x != 0) {
+        ++res;
+        x >>= 1;
+      }
+      return res;
+    }
+
+    // Ids are strictly increasing, so the gaps are stored minus one.
+    void packBlock(const std::uint32_t* ids, std::uint32_t n, BlockHeader& header, std::vector<std::uint32_t>& words) {
+      std::uint32_t maxGap = 0;
+      for (std::uint32_t k = 1; k < n; ++k)
+        maxGap = std::max(maxGap, ids[k] - ids[k - 1] - 1);
+
+      header.first = ids[0];
+      header.last = ids[n - 1];
+      header.wordOffset = static_cast<std::uint32_t>(words.size());
+      header.width = bitWidth(maxGap);
+
+      const std::uint64_t bits = static_cast<std::uint64_t>(n - 1) * header.width;
+      const size_t base = words.size();
+      words.resize(base + (bits + 31) / 32, 0);
+      if (header.width == 0)
+        return;
+      for (std::uint32_t k = 1; k < n; ++k) {
+        const std::uint64_t bit = static_cast<std::uint64_t>(k - 1) * header.width;
+        const std::uint64_t gap = static_cast<std::uint64_t>(ids[k] - ids[k - 1] - 1) << (bit % 32);
+        words[base + bit / 32] |= static_cast<std::uint32_t>(gap);
+        if (bit % 32 + header.width > 32)
+          words[base + bit / 32 + 1] |= static_cast<std::uint32_t>(gap >> 32);
+      }
+    }
+
+    // Fixed-width extraction first, prefix sum second: the first loop has no dependency between
+    // iterations and no branches, so the compiler is free to vectorize it.
+    std::uint32_t unpackBlock(const BlockHeader& header, const std::uint32_t* words, std::uint32_t n, std::uint32_t* out) {
+      const std::uint32_t* w = words + header.wordOffset;
+      const std::uint64_t mask = (std::uint64_t(1) << header.width) - 1;
+
+      out[0] = header.first;
+      for (std::uint32_t k = 1; k < n; ++k) {
+        const std::uint64_t bit = static_cast<std::uint64_t>(k - 1) * header.width;
+        const std::uint64_t chunk = w[bit / 32] | static_cast<std::uint64_t>(w[bit / 32 + 1]) << 32;
+        out[k] = static_cast<std::uint32_t>((chunk >> (bit % 32)) & mask) + 1;
+      }
+      for (std::uint32_t k = 1; k < n; ++k)
+        out[k] += out[k - 1];
+      return n;
+    }
+
+    // Cursor over a posting list that can unpack one block at a time.
+    class PostingList {
+      public:
+        PostingList(const unsigned char* postings, const TrigramEntry& e) :
+          count_(e.count),
+          blocks_(reinterpret_cast<const BlockHeader*>(postings + e.offset)),
+          blockCount_((e.count + blockSize - 1) / blockSize),
+          words_(reinterpret_cast<const std::uint32_t*>(blocks_ + blockCount_)),
+          at_(0),
+          loaded_(blockCount_),
+          next_(0)
+        {}
+
+        std::uint32_t count() const {
+          return count_;
+        }
+        std::uint32_t blockCount() const {
+          return blockCount_;
+        }
+
+        std::uint32_t unpack(std::uint32_t b, std::uint32_t* out) const {
+          return unpackBlock(blocks_[b], words_, blockLength_(b), out);
+        }
+
+        // Keeps the ids of @|{candidates (sorted) that are in this list.
+        // Successive calls must pass increasing candidates: the cursor only moves forward.
+        void intersect(std::vector<SymbolId>& candidates) {
+          size_t kept = 0;
+          for (const SymbolId id : candidates) {
+            while (at_ < blockCount_ && blocks_[at_].last < id)
+              ++at_;
+            if (at_ == blockCount_)
+              break;
+            if (blocks_[at_].first > id)
+              continue;
+
+            if (loaded_ != at_)
+              unpack(at_, buf_);
+            loaded_ = at_;
+
+            if (std::binary_search(buf_, buf_ + blockLength_(at_), id))
+              candidates[kept++] = id;
+          }
+          candidates.resize(kept);
+        }
+
+        // Reads the ids one at a time, for merging lists. Not to be mixed with @|{intersect@|}.
+        bool done() const {
+          return at_ == blockCount_;
+        }
+        SymbolId current() {
+          if (loaded_ != at_)
+            unpack(at_, buf_);
+          loaded_ = at_;
+          return buf_[next_];
+        }
+        void advance() {
+          if (++next_ == blockLength_(at_)) {
+            ++at_;
+            next_ = 0;
+          }
+        }
+
+      private:
+        std::uint32_t blockLength_(std::uint32_t b) const {
+          return std::min(blockSize, count_ - b * blockSize);
+        }
+
+        std::uint32_t count_;
+        const BlockHeader* blocks_;
+        std::uint32_t blockCount_;
+        const std::uint32_t* words_;
+
+        std::uint32_t at_;
+        std::uint32_t loaded_;
+        std::uint32_t next_;
+        std::uint32_t buf_[blockSize];
+    };
+
+    // Builds the posting lists of @|{postings@|}, in trigram order.
+    void packPostings(
+      const std::unordered_map<std::uint32_t, std::vector<SymbolId>>& postings,
+      std::vector<TrigramEntry>& entries,
+      std::vector<std::uint32_t>& postingWords
+    ) {
+      std::vector<std::uint32_t> trigramKeys;
+      for (const auto& entry : postings)
+        trigramKeys.push_back(entry.first);
+      std::sort(trigramKeys.begin(), trigramKeys.end());
+
+      for (const std::uint32_t t : trigramKeys) {
+        const std::vector<SymbolId>& ids = postings.at(t);
+        const std::uint32_t count = static_cast<std::uint32_t>(ids.size());
+        const std::uint32_t blockCount = (count + blockSize - 1) / blockSize;
+        entries.push_back(TrigramEntry{t, count, postingWords.size() * sizeof(std::uint32_t)});
+
+        std::vector<BlockHeader> blocks(blockCount);
+        std::vector<std::uint32_t> words;
+        for (std::uint32_t b = 0; b < blockCount; ++b)
+          packBlock(ids.data() + b * blockSize, std::min(blockSize, count - b * blockSize), blocks[b], words);
+        words.push_back(0);
+        words.push_back(0);
+
+        const std::uint32_t* blockWords = reinterpret_cast<const std::uint32_t*>(blocks.data());
+        postingWords.insert(postingWords.end(), blockWords, blockWords + blocks.size() * sizeof(BlockHeader) / sizeof(std::uint32_t));
+        postingWords.insert(postingWords.end(), words.begin(), words.end());
+      }
+    }
+
+    void addTrigrams(std::unordered_map<std::uint32_t, std::vector<SymbolId>>& postings, std::string_view folded, SymbolId id) {
+      for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+        std::vector<SymbolId>& list = postings[trigramAt(folded, i)];
+        if (list.empty() || list.back() != id)
+          list.push_back(id);
+      }
+    }
+
+    // The posting lists of every trigram of @|{folded in @|{section@|}, shortest first.
+    // False if one of the trigrams has no list, in which case nothing in @|{section contains @|{folded@|}.
+    bool postingListsFor(const unsigned char* data, const TrigramSection& section, std::string_view folded, std::vector<PostingList>& out) {
+      const TrigramEntry* trigrams = reinterpret_cast<const TrigramEntry*>(data + section.offset);
+      const TrigramEntry* trigramsEnd = trigrams + section.count;
+      const unsigned char* postings = reinterpret_cast<const unsigned char*>(trigramsEnd);
+
+      std::vector<std::uint32_t> queryTrigrams;
+      for (size_t i = 0; i + 3 <= folded.size(); ++i)
+        queryTrigrams.push_back(trigramAt(folded, i));
+      std::sort(queryTrigrams.begin(), queryTrigrams.end());
+      queryTrigrams.erase(std::unique(queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+
+      for (const std::uint32_t t : queryTrigrams) {
+        const TrigramEntry* e = std::lower_bound(trigrams, trigramsEnd, t, [](const TrigramEntry& x, std::uint32_t y) {
+          return x.trigram < y;
+        });
+        if (e == trigramsEnd || e->trigram != t)
+          return false;
+        out.emplace_back(postings, *e);
+      }
+
+      std::sort(out.begin(), out.end(), [](const PostingList& a, const PostingList& b) {
+        return a.count() < b.count();
+      });
+      return true;
+    }
+
+    // The posting lists of the trigrams that start with @|{folded@|}, which is under three characters.
+    // Strings are indexed with two NULs after them, so any of their one or two character substrings
+    // starts a trigram.
+    void postingListsStartingWith(const unsigned char* data, const TrigramSection& section, std::string_view folded, std::vector<PostingList>& out) {
+      const TrigramEntry* trigrams = reinterpret_cast<const TrigramEntry*>(data + section.offset);
+      const TrigramEntry* trigramsEnd = trigrams + section.count;
+      const unsigned char* postings = reinterpret_cast<const unsigned char*>(trigramsEnd);
+
+      std::uint32_t first = 0;
+      for (size_t i = 0; i < 3; ++i)
+        first = first << 8 | (i < folded.size() ? static_cast<unsigned char>(folded[i]) : 0);
+      const std::uint32_t last = first | (0xffffffu >> (8 * folded.size()));
+
+      const TrigramEntry* e = std::lower_bound(trigrams, trigramsEnd, first, [](const TrigramEntry& x, std::uint32_t y) {
+        return x.trigram < y;
+      });
+      for (; e != trigramsEnd && e->trigram <= last; ++e)
+        out.emplace_back(postings, *e);
+    }
+
+    // Calls @|{f with the ids that are in any of @|{lists@|}, once each and in increasing order, until it returns false.
+    template<typename F>
+    void forEachInAny(std::vector<PostingList>& lists, F f) {
+      using Head = std::pair<SymbolId, size_t>;
+      std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+      for (size_t i = 0; i < lists.size(); ++i)
+        heads.emplace(lists[i].current(), i);
+
+      bool first = true;
+      SymbolId previous = 0;
+      while (!heads.empty()) {
+        const Head h = heads.top();
+        heads.pop();
+        if (first || h.first != previous) {
+          if (!f(h.first))
+            return;
+          first = false;
+          previous = h.first;
+        }
+
+        PostingList& l = lists[h.second];
+        l.advance();
+        if (!l.done())
+          heads.emplace(l.current(), h.second);
+      }
+    }
+
+    // Calls @|{f with the ids that are in all of @|{lists@|}, in increasing order, until it returns false.
+    // Goes one block of the shortest list at a time, so stopping early leaves the rest packed.
+    template<typename F>
+    void forEachInAll(std::vector<PostingList>& lists, F f) {
+      std::uint32_t buf[blockSize];
+      std::vector<SymbolId> candidates;
+      for (std::uint32_t b = 0; b < lists.front().blockCount(); ++b) {
+        const std::uint32_t n = lists.front().unpack(b, buf);
+        candidates.assign(buf, buf + n);
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+          lists[i].intersect(candidates);
+
+        for (const SymbolId id : candidates)
+          if (!f(id))
+            return;
+      }
+    }
+
+    // Whether @|{count items of @|{itemSize bytes starting at @|{offset fit in @|{size bytes.
+    bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t itemSize, std::uint64_t size) {
+      return offset <= size && count <= (size - offset) / itemSize;
+    }
+
+    bool validString(const FileHeader& h, StringRef s) {
+      return fits(s.offset, s.size, 1, h.stringsSize);
+    }
+
+    // Every block header of every list, and the words it points to, within the section.
+    // Ids past @|{last in a corrupt block are left to the search to skip.
+    bool validTrigrams(const unsigned char* data, size_t size, const FileHeader& h, const TrigramSection& section) {
+      if (section.offset % 8 != 0 || !fits(section.offset, section.count, sizeof(TrigramEntry), size))
+        return false;
+      const std::uint64_t postingsOffset = section.offset + section.count * sizeof(TrigramEntry);
+      if (!fits(postingsOffset, section.postingsSize, 1, size))
+        return false;
+
+      const TrigramEntry* trigrams = reinterpret_cast<const TrigramEntry*>(data + section.offset);
+      for (std::uint64_t t = 0; t < section.count; ++t) {
+        const TrigramEntry& e = trigrams[t];
+        if (e.count == 0 || (t > 0 && trigrams[t - 1].trigram >= e.trigram) || e.offset % 4 != 0)
+          return false;
+
+        const std::uint32_t blockCount = (e.count + blockSize - 1) / blockSize;
+        if (!fits(e.offset, blockCount, sizeof(BlockHeader), section.postingsSize))
+          return false;
+        const std::uint64_t wordsOffset = e.offset + blockCount * sizeof(BlockHeader);
+        const std::uint64_t wordCount = (section.postingsSize - wordsOffset) / sizeof(std::uint32_t);
+
+        const BlockHeader* blocks = reinterpret_cast<const BlockHeader*>(data + postingsOffset + e.offset);
+        for (std::uint32_t b = 0; b < blockCount; ++b) {
+          const BlockHeader& block = blocks[b];
+          const std::uint64_t n = std::min(blockSize, e.count - b * blockSize);
+          if (block.first > block.last || block.last >= h.symbolCount || block.width > 32)
+            return false;
+          // unpacking reads up to two words past the last one that holds a gap
+          if (!fits(block.wordOffset, ((n - 1) * block.width + 31) / 32 + 2, 1, wordCount))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    // Bounds of every section, string and index in the file, so that a truncated or corrupt file
+    // (say, from a crash in a previous write) is rejected on load instead of read out of bounds.
+    bool validIndex(const unsigned char* data, size_t size) {
+      const FileHeader& h = headerOf(data);
+      if (std::memcmp(h.magic, magic, sizeof(magic)) != 0)
+        return false;
+
+      if (
+        h.nameOrderOffset % 8 != 0 || h.symbolsOffset % 8 != 0 || h.tusOffset % 8 != 0 ||
+        !fits(h.nameOrderOffset, h.symbolCount, sizeof(SymbolId), size) ||
+        !fits(h.symbolsOffset, h.symbolCount, sizeof(SymbolRecord), size) ||
+        !fits(h.tusOffset, h.tuCount, sizeof(StringRef), size) ||
+        !fits(h.stringsOffset, h.stringsSize, 1, size)
+      )
+        return false;
+
+      const StringRef* tus = reinterpret_cast<const StringRef*>(data + h.tusOffset);
+      for (std::uint32_t t = 0; t < h.tuCount; ++t)
+        if (!validString(h, tus[t]))
+          return false;
+
+      const SymbolId* nameOrder = reinterpret_cast<const SymbolId*>(data + h.nameOrderOffset);
+      const SymbolRecord* symbols = reinterpret_cast<const SymbolRecord*>(data + h.symbolsOffset);
+      for (std::uint32_t id = 0; id < h.symbolCount; ++id) {
+        if (nameOrder[id] >= h.symbolCount)
+          return false;
+        const SymbolRecord& r = symbols[id];
+        if (!validString(h, r.name) || !validString(h, r.qualifiedName) || r.tu >= h.tuCount)
+          return false;
+      }
+
+      return validTrigrams(data, size, h, h.qualifiedNameTrigrams) && validTrigrams(data, size, h, h.nameTrigrams);
+    }
+
+    void writePadding(std::ofstream& out, std::uint64_t& pos, std::uint64_t alignment) {
+      static const char zeros[8] = {};
+      const std::uint64_t pad = (alignment - pos % alignment) % alignment;
+      out.write(zeros, static_cast<std::streamsize>(pad));
+      pos += pad;
+    }
+
+    template<typename T>
+    void writeArray(std::ofstream& out, std::uint64_t& pos, const std::vector<T>& xs) {
+      out.write(reinterpret_cast<const char*>(xs.data()), static_cast<std::streamsize>(xs.size() * sizeof(T)));
+      pos += xs.size() * sizeof(T);
+    }
+  }
+
+  MappedSymbolIndex::MappedSymbolIndex() :
+    data_(nullptr),
+    size_(0)
+  {}
+
+  MappedSymbolIndex::MappedSymbolIndex(const char* path) :
+    MappedSymbolIndex()
+  {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      const int err = errno;
+      close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ < sizeof(FileHeader)) {
+      close(fd);
+      throw std::runtime_error(std::string(path) + ": not a clangDoc symbol index");
+    }
+
+    void* m = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int err = errno;
+    close(fd);
+    if (m == MAP_FAILED)
+      throw std::system_error(err, std::generic_category(), path);
+    data_ = static_cast<const unsigned char*>(m);
+
+    if (!validIndex(data_, size_)) {
+      munmap(const_cast<unsigned char*>(data_), size_);
+      data_ = nullptr;
+      throw std::runtime_error(std::string(path) + ": not a clangDoc symbol index");
+    }
+  }
+
+  MappedSymbolIndex::~MappedSymbolIndex() {
+    if (data_ != nullptr)
+      munmap(const_cast<unsigned char*>(data_), size_);
+  }
+
+  std::uint32_t MappedSymbolIndex::size() const {
+    return headerOf(data_).symbolCount;
+  }
+
+  std::string_view MappedSymbolIndex::nameOf(SymbolId id) const {
+    assert(id < size());
+    return stringAt(data_, symbolAt(data_, id).name);
+  }
+
+  std::string_view MappedSymbolIndex::qualifiedNameOf(SymbolId id) const {
+    assert(id < size());
+    return stringAt(data_, symbolAt(data_, id).qualifiedName);
+  }
+
+  std::string_view MappedSymbolIndex::tuOf(SymbolId id) const {
+    assert(id < size());
+    const StringRef* tus = reinterpret_cast<const StringRef*>(data_ + headerOf(data_).tusOffset);
+    return stringAt(data_, tus[symbolAt(data_, id).tu]);
+  }
+
+  std::vector<SymbolId> MappedSymbolIndex::search(std::string_view query, size_t limit) const {
+    std::vector<SymbolId> res;
+    if (limit == 0)
+      return res;
+
+    const FileHeader& h = headerOf(data_);
+    const std::string folded = foldCase(query);
+
+    // names equal to the query ignoring case, then names starting with it, are one run of the name order
+    const SymbolId* order = reinterpret_cast<const SymbolId*>(data_ + h.nameOrderOffset);
+    const SymbolId* orderEnd = order + h.symbolCount;
+    const SymbolId* prefixBegin = std::lower_bound(order, orderEnd, folded, [this](SymbolId id, const std::string& q) {
+      return compareFolded(nameOf(id), q) < 0;
+    });
+    const SymbolId* prefixEnd = std::upper_bound(prefixBegin, orderEnd, folded, [this](const std::string& q, SymbolId id) {
+      return compareFolded(nameOf(id).substr(0, q.size()), q) > 0;
+    });
+    const SymbolId* exactEnd = prefixBegin;
+    while (exactEnd != prefixEnd && nameOf(*exactEnd).size() == folded.size())
+      ++exactEnd;
+
+    std::vector<SymbolId> exact(prefixBegin, exactEnd);
+    const size_t exactCount = std::min(limit, exact.size());
+    std::partial_sort(exact.begin(), exact.begin() + static_cast<std::ptrdiff_t>(exactCount), exact.end(), [&](SymbolId a, SymbolId b) {
+      const bool aSameCase = nameOf(a) == query;
+      const bool bSameCase = nameOf(b) == query;
+      if (aSameCase != bSameCase)
+        return aSameCase;
+      if (qualifiedNameOf(a).size() != qualifiedNameOf(b).size())
+        return qualifiedNameOf(a).size() < qualifiedNameOf(b).size();
+      return a < b;
+    });
+    res.assign(exact.begin(), exact.begin() + static_cast<std::ptrdiff_t>(exactCount));
+
+    for (const SymbolId* it = exactEnd; it != prefixEnd && res.size() < limit; ++it)
+      res.push_back(*it);
+
+    // every name starts with the empty query
+    if (folded.empty())
+      return res;
+
+    // The rest comes in id order, so both scans stop as soon as there are enough results.
+    // Queries under three characters merge the lists of the trigrams they start instead.
+    const auto forEachCandidate = [&](const TrigramSection& section, const auto& f) {
+      // the gaps are not checked on load
+      const auto checked = [&](SymbolId id) {
+        return id >= h.symbolCount || f(id);
+      };
+
+      std::vector<PostingList> lists;
+      if (folded.size() < 3) {
+        postingListsStartingWith(data_, section, folded, lists);
+        if (!lists.empty())
+          forEachInAny(lists, checked);
+      }
+      else if (postingListsFor(data_, section, folded, lists))
+        forEachInAll(lists, checked);
+    };
+
+    // a name never has "::" in it
+    if (res.size() < limit && folded.find(':') == std::string::npos)
+      forEachCandidate(h.nameTrigrams, [&](SymbolId id) {
+        const std::string_view name = nameOf(id);
+        if (containsFolded(name, folded) && !startsWithFolded(name, folded))
+          res.push_back(id);
+        return res.size() < limit;
+      });
+
+    if (res.size() < limit)
+      forEachCandidate(h.qualifiedNameTrigrams, [&](SymbolId id) {
+        if (!containsFolded(nameOf(id), folded) && containsFolded(qualifiedNameOf(id), folded))
+          res.push_back(id);
+        return res.size() < limit;
+      });
+
+    return res;
+  }
+
+  SymbolIndexBuilder::SymbolIndexBuilder(const MappedSymbolIndex& previous) {
+    for (SymbolId id = 0; id < previous.size(); ++id)
+      symbolsByTU_[std::string(previous.tuOf(id))].push_back(Symbol{
+        std::string(previous.nameOf(id)),
+        std::string(previous.qualifiedNameOf(id))
+      });
+  }
+
+  void SymbolIndexBuilder::add(const std::string& tu, std::string name, std::string qualifiedName) {
+    if (qualifiedName.empty())
+      qualifiedName = name;
+    symbolsByTU_[tu].push_back(Symbol{std::move(name), std::move(qualifiedName)});
+  }
+
+  void SymbolIndexBuilder::removeTU(const std::string& tu) {
+    symbolsByTU_.erase(tu);
+  }
+
+  void SymbolIndexBuilder::write(const std::string& path) const {
+    std::vector<const std::string*> tuNames;
+    for (const auto& entry : symbolsByTU_)
+      tuNames.push_back(&entry.first);
+    std::sort(tuNames.begin(), tuNames.end(), [](const std::string* a, const std::string* b) {
+      return *a < *b;
+    });
+
+    std::string strings;
+    const auto addString = [&strings](std::string_view s) {
+      const StringRef res{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(s.size())};
+      strings += s;
+      return res;
+    };
+
+    std::vector<StringRef> tus;
+    std::vector<SymbolRecord> symbols;
+    std::vector<std::string> foldedNames;
+    std::unordered_map<std::uint32_t, std::vector<SymbolId>> qualifiedNamePostings;
+    std::unordered_map<std::uint32_t, std::vector<SymbolId>> namePostings;
+    for (const std::string* tu : tuNames) {
+      const std::uint32_t tuIndex = static_cast<std::uint32_t>(tus.size());
+      tus.push_back(addString(*tu));
+
+      for (const Symbol& s : symbolsByTU_.at(*tu)) {
+        const SymbolId id = static_cast<SymbolId>(symbols.size());
+
+        SymbolRecord r;
+        r.qualifiedName = addString(s.qualifiedName);
+        // the name usually ends the qualified name
+        const std::string_view qualifiedName(s.qualifiedName);
+        if (qualifiedName.size() >= s.name.size() && qualifiedName.substr(qualifiedName.size() - s.name.size()) == s.name)
+          r.name = StringRef{r.qualifiedName.offset + r.qualifiedName.size - static_cast<std::uint32_t>(s.name.size()), static_cast<std::uint32_t>(s.name.size())};
+        else
+          r.name = addString(s.name);
+        r.tu = tuIndex;
+        symbols.push_back(r);
+
+        // see postingListsStartingWith
+        addTrigrams(qualifiedNamePostings, foldCase(s.qualifiedName) + std::string(2, '\0'), id);
+        foldedNames.push_back(foldCase(s.name));
+        addTrigrams(namePostings, foldedNames.back() + std::string(2, '\0'), id);
+      }
+    }
+
+    std::vector<SymbolId> nameOrder(symbols.size());
+    for (SymbolId id = 0; id < nameOrder.size(); ++id)
+      nameOrder[id] = id;
+    std::sort(nameOrder.begin(), nameOrder.end(), [&foldedNames](SymbolId a, SymbolId b) {
+      const int c = foldedNames[a].compare(foldedNames[b]);
+      return c != 0 ? c < 0 : a < b;
+    });
+
+    std::vector<TrigramEntry> qualifiedNameTrigrams;
+    std::vector<std::uint32_t> qualifiedNamePostingWords;
+    packPostings(qualifiedNamePostings, qualifiedNameTrigrams, qualifiedNamePostingWords);
+    std::vector<TrigramEntry> nameTrigrams;
+    std::vector<std::uint32_t> namePostingWords;
+    packPostings(namePostings, nameTrigrams, namePostingWords);
+
+    const std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw std::system_error(errno, std::generic_category(), tmpPath);
+
+      FileHeader h{};
+      std::memcpy(h.magic, magic, sizeof(magic));
+      h.symbolCount = static_cast<std::uint32_t>(symbols.size());
+      h.tuCount = static_cast<std::uint32_t>(tus.size());
+
+      std::uint64_t pos = sizeof(FileHeader);
+      out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+      const auto writeTrigrams = [&](TrigramSection& section, const std::vector<TrigramEntry>& entries, const std::vector<std::uint32_t>& words) {
+        writePadding(out, pos, 8);
+        section.offset = pos;
+        section.count = entries.size();
+        section.postingsSize = words.size() * sizeof(std::uint32_t);
+        writeArray(out, pos, entries);
+        writeArray(out, pos, words);
+      };
+      writeTrigrams(h.qualifiedNameTrigrams, qualifiedNameTrigrams, qualifiedNamePostingWords);
+      writeTrigrams(h.nameTrigrams, nameTrigrams, namePostingWords);
+
+      writePadding(out, pos, 8);
+      h.nameOrderOffset = pos;
+      writeArray(out, pos, nameOrder);
+
+      writePadding(out, pos, 8);
+      h.symbolsOffset = pos;
+      writeArray(out, pos, symbols);
+
+      writePadding(out, pos, 8);
+      h.tusOffset = pos;
+      writeArray(out, pos, tus);
+
+      writePadding(out, pos, 8);
+      h.stringsOffset = pos;
+      h.stringsSize = strings.size();
+      out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+      out.seekp(0);
+      out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      if (!out)
+        throw std::system_error(errno, std::generic_category(), tmpPath);
+    }
+
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+      throw std::system_error(errno, std::generic_category(), path);
+  }
+}
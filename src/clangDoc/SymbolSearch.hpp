@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "util.hpp"
+
+namespace clangdoc {
+  // Position of a symbol in a written index. Not stable across rewrites.
+  using SymbolId = std::uint32_t;
+
+  class MappedSymbolIndex;
+  class SymbolIndexBuilder;
+
+  // Read side of the symbol index: a file written by @|{SymbolIndexBuilder::write@|}, mapped in as is.
+  //
+  // Every symbol is indexed by the case-folded trigrams of its qualified name, and separately of its
+  // name. A trigram's posting list holds the ids of its symbols in blocks of 128: the first id as is,
+  // then the gaps to the following ids bit-packed at the smallest width that fits the block. Blocks
+  // carry their id range, so intersecting lists only unpacks the blocks that can hold a candidate.
+  // A table of the ids sorted by case-folded name answers exact and prefix matches by binary search.
+  class MappedSymbolIndex {
+    public:
+      // throws @|{std::system_error if the file cannot be mapped and @|{std::runtime_error if it is not an index
+      explicit MappedSymbolIndex(const char* path);
+      ~MappedSymbolIndex();
+
+      mimpl_cpp_nocopy(MappedSymbolIndex)
+      mimpl_cpp_copy_and_swap(MappedSymbolIndex) {
+        using std::swap;
+        swap(a.data_, b.data_);
+        swap(a.size_, b.size_);
+      }
+
+      std::uint32_t size() const;
+
+      std::string_view nameOf(SymbolId id) const;
+      std::string_view qualifiedNameOf(SymbolId id) const;
+      // whatever the symbol was added with, the path of its file for clangDoc
+      std::string_view tuOf(SymbolId id) const;
+
+      // Ids of the symbols whose name or qualified name contains @|{query@|}, ignoring ASCII case, best first:
+      // - exact name, same case first, then shorter qualified names first
+      // - name prefix, in name order
+      // - name substring, in id order
+      // - qualified name substring, in id order
+      // Only the first @|{limit are looked at, so the cost follows @|{limit rather than the number of matches.
+      std::vector<SymbolId> search(std::string_view query, size_t limit = 50) const;
+
+    private:
+      MappedSymbolIndex();
+
+      const unsigned char* data_;
+      size_t size_;
+  };
+
+  // Write side of the symbol index.
+  // Symbols are grouped by TU so that a run over a few changed TUs can replace just their symbols
+  // in an index loaded from the previous run.
+  class SymbolIndexBuilder {
+    public:
+      SymbolIndexBuilder() = default;
+      // starts out with every symbol of @|{previous
+      explicit SymbolIndexBuilder(const MappedSymbolIndex& previous);
+
+      void add(const std::string& tu, std::string name, std::string qualifiedName);
+      // drops the symbols added for @|{tu@|}, e.g. before adding its new ones
+      void removeTU(const std::string& tu);
+
+      // Writes to a temporary file next to @|{path and renames it over @|{path@|},
+      // so a mapping of the old index stays valid.
+      // throws @|{std::system_error if the file cannot be written
+      void write(const std::string& path) const;
+
+    private:
+      struct Symbol {
+        std::string name;
+        std::string qualifiedName;
+      };
+
+      std::unordered_map<std::string, std::vector<Symbol>> symbolsByTU_;
+  };
+}
@@ -1,20 +1,50 @@
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_set>
 #include "ClangWrappers.hpp"
+#include "HeaderBatches.hpp"
+#include "LineTables.hpp"
+#include "PCHGroups.hpp"
+#include "SymbolSearch.hpp"
 
 using namespace std;
 using namespace clangw;
+using namespace clangdoc;
 
 ostream& operator<<(ostream& stream, const CXString& str);
 
-int main() {
-  shared_ptr<Index> i = make_shared<Index>(false, true);
-  shared_ptr<TranslationUnit> tu = make_shared<TranslationUnit>(i->makeTranslationUnit(
-    "header.hpp",
-    nullptr, 0,
-    nullptr, 0
-  ));
+// set with --index
+static unique_ptr<SymbolIndexBuilder> symbolIndex;
 
-  TokenArray ta{shared_ptr<TranslationUnit>(tu)};
+static string qualifiedNameOf(Cursor c) {
+  string res = c.spelling().cstr();
+  for (Cursor p = c.semanticParent(); p.kind().valid() && !p.kind().translationUnit(); p = p.semanticParent()) {
+    const string scope = p.spelling().cstr();
+    if (!scope.empty())
+      res = scope + "::" + res;
+  }
+  return res;
+}
+
+// Only looks at @|{header when it is not null, and at the main file otherwise.
+static void documentFile(shared_ptr<TranslationUnit> tu, CXFile header) {
+  TokenArray ta = header == nullptr ?
+    TokenArray{shared_ptr<TranslationUnit>(tu)} :
+    TokenArray{shared_ptr<TranslationUnit>(tu), tu->extentOf(header)};
+
+  // symbols are filed under the header, or under the main file
+  // normalized, since the same header is named as typed when parsed alone and by its absolute path in an umbrella
+  const string tuName = filesystem::absolute(
+    header == nullptr ? tu->spelling().cstr() : String(clang_getFileName(header)).cstr()
+  ).lexically_normal().string();
+  unordered_set<string> indexedUSRs;
+  if (symbolIndex != nullptr)
+    symbolIndex->removeTU(tuName);
 
   Cursor lastDecl{};
   unsigned int lastComment = 0;
@@ -33,6 +63,13 @@ int main() {
     Cursor c = tu->cursorAt(ta.locationOfTokenAt(n));
     if (!c.kind().declaration())
       continue;
+    // umbrella TUs: a token of the header can still resolve to a cursor from elsewhere
+    if (header != nullptr && clang_File_isEqual(c.file(), header) == 0)
+      continue;
+
+    // parameters would only drown out the symbols worth searching for
+    if (symbolIndex != nullptr && c.kind().raw != CXCursor_ParmDecl && indexedUSRs.insert(c.usr().cstr()).second)
+      symbolIndex->add(tuName, c.spelling().cstr(), qualifiedNameOf(c));
 
     if (justFoundComment)
       printf("%s (%s)\n%s\n%s (%s)\n",
@@ -43,6 +80,179 @@ int main() {
 
     lastDecl = c;
   }
+}
+
+static void documentTranslationUnit(shared_ptr<TranslationUnit> tu) {
+  documentFile(std::move(tu), nullptr);
+}
+
+// Times @|{LocationDecoder against one @|{clang_getSpellingLocation@|} call per location, over every token
+// of @|{tu and the cursors they resolve to, and checks that both give the same results.
+static int benchLocations(shared_ptr<TranslationUnit> tu) {
+  TokenArray ta{shared_ptr<TranslationUnit>(tu)};
+  vector<Cursor> cursors;
+  for (unsigned int n = 0; n < ta.size(); ++n)
+    cursors.push_back(tu->cursorAt(ta.locationOfTokenAt(n)));
+
+  constexpr int rounds = 20;
+  vector<DecodedLocation> perCall(ta.size() + cursors.size());
+  vector<DecodedLocation> batchTokens;
+  vector<DecodedLocation> batchCursors;
+
+  const auto perCallStart = chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    size_t k = 0;
+    for (unsigned int n = 0; n < ta.size(); ++n, ++k) {
+      DecodedLocation& l = perCall[k];
+      clang_getSpellingLocation(ta.locationOfTokenAt(n), &l.file, &l.line, &l.column, &l.offset);
+    }
+    for (Cursor& c : cursors) {
+      DecodedLocation& l = perCall[k++];
+      clang_getSpellingLocation(c.location(), &l.file, &l.line, &l.column, &l.offset);
+    }
+  }
+  const auto perCallEnd = chrono::steady_clock::now();
+
+  // line tables are rebuilt every round, they are part of the cost
+  for (int r = 0; r < rounds; ++r) {
+    LocationDecoder d(tu);
+    d.decodeTokenLocations(ta, batchTokens);
+    d.decodeCursorLocations(cursors.data(), cursors.size(), batchCursors);
+  }
+  const auto batchEnd = chrono::steady_clock::now();
+
+  size_t mismatches = 0;
+  for (size_t k = 0; k < perCall.size(); ++k) {
+    const DecodedLocation& a = perCall[k];
+    const DecodedLocation& b = k < batchTokens.size() ? batchTokens[k] : batchCursors[k - batchTokens.size()];
+    if (a.file != b.file || a.line != b.line || a.column != b.column || a.offset != b.offset)
+      ++mismatches;
+  }
+
+  const auto nsPerLocation = [&](chrono::steady_clock::duration d) {
+    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(d).count()) / (rounds * static_cast<double>(perCall.size()));
+  };
+  printf("%zu locations (%u tokens, %zu cursors), %d rounds\n", perCall.size(), ta.size(), cursors.size(), rounds);
+  printf("per call: %.1f ns/location\n", nsPerLocation(perCallEnd - perCallStart));
+  printf("batch:    %.1f ns/location\n", nsPerLocation(batchEnd - perCallEnd));
+  printf("%zu mismatches\n", mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
+
+// clangDoc [--index <file>] ...                      also index the documented symbols into <file>, updating it if it exists
+// clangDoc                                              document header.hpp
+// clangDoc <build dir> [<pch dir>]                     document every file in <build dir>/compile_commands.json
+// clangDoc --headers [--batch-size <n>] <header>...    document headers, parsing <n> of them per TU (default 32)
+// clangDoc --search <file> <query> [<n>]               print the <n> best matches for <query> in the index <file> (default 20)
+// clangDoc --bench-locations [<source>]                compare batch and per-call location decoding on <source> (default header.hpp)
+int main(int argc, char** argv) {
+  if (argc > 3 && string(argv[1]) == "--search") {
+    size_t limit = 20;
+    if (argc > 4) {
+      const char* value = argv[4];
+      char* end = nullptr;
+      errno = 0;
+      const unsigned long n = strtoul(value, &end, 10);
+      if (*value < '0' || *value > '9' || *end != '\0' || errno == ERANGE || n == 0) {
+        cerr << "clangDoc: --search takes a positive number of results, got '" << value << "'\n"
+             << "usage: clangDoc --search <file> <query> [<n>]\n";
+        return 2;
+      }
+      limit = n;
+    }
+
+    MappedSymbolIndex index(argv[2]);
+    for (const SymbolId id : index.search(argv[3], limit))
+      cout << index.qualifiedNameOf(id) << " (" << index.tuOf(id) << ")\n";
+    return 0;
+  }
+
+  if (argc > 1 && string(argv[1]) == "--bench-locations") {
+    shared_ptr<Index> i = make_shared<Index>(false, true);
+    return benchLocations(make_shared<TranslationUnit>(i->makeTranslationUnit(
+      argc > 2 ? argv[2] : "header.hpp",
+      nullptr, 0,
+      nullptr, 0
+    )));
+  }
+
+  string indexPath;
+  if (argc > 2 && string(argv[1]) == "--index") {
+    indexPath = argv[2];
+    argc -= 2;
+    argv += 2;
+
+    symbolIndex = make_unique<SymbolIndexBuilder>();
+    if (filesystem::exists(indexPath)) {
+      // a broken or older index is rebuilt from scratch, one that cannot be read is an error
+      try {
+        symbolIndex = make_unique<SymbolIndexBuilder>(MappedSymbolIndex(indexPath.c_str()));
+      }
+      catch (const system_error&) {
+        throw;
+      }
+      catch (const runtime_error& e) {
+        cerr << "clangDoc: starting a new index: " << e.what() << '\n';
+      }
+    }
+  }
+
+  // Excluding PCH declarations only affects clang_visitChildren and indexing, which documentFile
+  // does not use, since it walks tokens. It is set for a walk with a cursor visitor, which would
+  // otherwise go through the declarations of the group PCH again for every TU.
+  shared_ptr<Index> i = make_shared<Index>(true, true);
+
+  // set when a file gets skipped, the rest still gets documented and indexed
+  bool failed = false;
+  if (argc < 2) {
+    documentTranslationUnit(make_shared<TranslationUnit>(i->makeTranslationUnit(
+      "header.hpp",
+      nullptr, 0,
+      nullptr, 0
+    )));
+  }
+  else if (string(argv[1]) == "--headers") {
+    size_t batchSize = 32;
+    int firstHeader = 2;
+    if (argc > 2 && string(argv[2]) == "--batch-size") {
+      const char* value = argc > 3 ? argv[3] : "";
+      char* end = nullptr;
+      const unsigned long n = strtoul(value, &end, 10);
+      if (*value < '0' || *value > '9' || *end != '\0' || n == 0) {
+        cerr << "clangDoc: --batch-size takes a positive number, got '" << value << "'\n"
+             << "usage: clangDoc --headers [--batch-size <n>] <header>...\n";
+        return 2;
+      }
+      batchSize = n;
+      firstHeader = 4;
+    }
+
+    failed = !documentHeaders(*i, vector<string>(argv + firstHeader, argv + argc), {}, batchSize, documentFile);
+  }
+  else {
+    CompilationDatabase db(argv[1]);
+    const string pchDir = argc > 2 ? string(argv[2]) : string(argv[1]) + "/clangDoc-pch";
+
+    vector<PCHGroup> groups = groupCompileJobs(readCompileJobs(db));
+    for (PCHGroup& g : groups) {
+      buildGroupPCH(*i, g, pchDir);
+      // a skipped file keeps its symbols from the previous index
+      for (const CompileJob& job : g.jobs) {
+        try {
+          documentTranslationUnit(make_shared<TranslationUnit>(parseInGroup(*i, g, job)));
+        }
+        catch (const clangerr& e) {
+          cerr << "clangDoc: skipping " << job.path << ": " << e.what() << '\n';
+          failed = true;
+        }
+      }
+    }
+  }
+
+  if (symbolIndex != nullptr)
+    symbolIndex->write(indexPath);
+  if (failed)
+    return 1;
 
   /*root.visitChildren([](Cursor c, Cursor, CXClientData) {
     if (!clang_Location_isFromMainFile(c.location()))